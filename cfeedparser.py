@@ -26,6 +26,10 @@ except ImportError:
 
 unicode_ = type('')
 
+# Length (in characters) of the plain text excerpt of summary/content given
+# in entries' text_snippet. 0 disables it.
+SNIPPET_LENGTH = 200
+
 _libpath = os.path.join(os.path.dirname(__file__) or ".", "libfeedparser.so")
 _lib = ctypes.cdll.LoadLibrary(_libpath)
 
@@ -49,7 +53,8 @@ class _EntryStruct(ctypes.Structure):
                 ('author_name', ctypes.c_char_p),
                 ('author_email', ctypes.c_char_p),
                 ('author_url', ctypes.c_char_p),
-                ('author', ctypes.c_char_p)]
+                ('author', ctypes.c_char_p),
+                ('text_snippet', ctypes.c_char_p)]
 
 class _FeedStruct(ctypes.Structure):
     _fields_ = [('entries', ctypes.POINTER(ctypes.POINTER(_EntryStruct))),
@@ -67,6 +72,11 @@ class _FeedStruct(ctypes.Structure):
                 ('author_url', ctypes.c_char_p),
                 ('author', ctypes.c_char_p)]
 
+class _TimelineStruct(ctypes.Structure):
+    _fields_ = [('entries', ctypes.POINTER(ctypes.POINTER(_EntryStruct))),
+                ('feeds', ctypes.POINTER(ctypes.c_void_p)),
+                ('entries_size', ctypes.c_int)]
+
 class Entry(UserDict):
     def __init__(self, struct):
         UserDict.__init__(self)
@@ -97,19 +107,30 @@ class Feed(UserDict):
     def __len__(self):
         return self.entries_size
 
+def parse_timestamp(date):
+    """UNIX timestamp of a W3DTF or RFC 822 date, as used by Aggregator, or
+    None if it can't be parsed"""
+    if isinstance(date, unicode_):
+        date = date.encode('utf-8')
+    return _lib.feed_parse_date(ctypes.c_char_p(date)) or None
+
 class ParseError(Exception):
     pass
 
 class Parser(object):
     _new_parser = _lib.feed_parser_new
     _get_error = _lib.feed_parser_get_error
+    _set_snippet_length = _lib.feed_parser_set_snippet_length
     _parse_file = _lib.feed_parser_parse_file
     _parse_string = _lib.feed_parser_parse_string
     _parser_free = _lib.feed_parser_free
     _feed_free = _lib.feed_free
     
-    def __init__(self):
+    def __init__(self, snippet_length=None):
         self.__ptr = ctypes.c_void_p(self._new_parser())
+        if snippet_length is None:
+            snippet_length = SNIPPET_LENGTH
+        self._set_snippet_length(self.__ptr, ctypes.c_int(snippet_length))
     
     def parse_file(self, file):
         if isinstance(file, unicode_):
@@ -136,12 +157,86 @@ class Parser(object):
     
     __del__ = free
 
+class Aggregator(object):
+    """Merge the entries of several feeds, newest first, without duplicates.
+
+    limit keeps only the `limit` newest entries, since drops entries older
+    than the given UNIX timestamp. Each merged entry has a `feed_index` key,
+    the position of its feed in the order of add_file/add_string calls."""
+
+    _new_aggregator = _lib.feed_aggregator_new
+    _set_limit = _lib.feed_aggregator_set_limit
+    _set_since = _lib.feed_aggregator_set_since
+    _set_snippet_length = _lib.feed_aggregator_set_snippet_length
+    _add_file = _lib.feed_aggregator_add_file
+    _add_string = _lib.feed_aggregator_add_string
+    _get_error = _lib.feed_aggregator_get_error
+    _merge = _lib.feed_aggregator_merge
+    _timeline_free = _lib.timeline_free
+    _aggregator_free = _lib.feed_aggregator_free
+
+    def __init__(self, limit=0, since=0, snippet_length=None):
+        self.__ptr = ctypes.c_void_p(self._new_aggregator())
+        self.__feeds = {}
+        if snippet_length is None:
+            snippet_length = SNIPPET_LENGTH
+        self._set_limit(self.__ptr, ctypes.c_int(limit))
+        self._set_since(self.__ptr, ctypes.c_longlong(int(since)))
+        self._set_snippet_length(self.__ptr, ctypes.c_int(snippet_length))
+
+    def add_file(self, file):
+        if isinstance(file, unicode_):
+            file = file.encode("utf-8")
+        return self._add_feed(self._add_file(self.__ptr, ctypes.c_char_p(file)))
+
+    def add_string(self, data):
+        if isinstance(data, unicode_):
+            data = data.encode('utf-8')
+        return self._add_feed(self._add_string(self.__ptr, ctypes.c_char_p(data), ctypes.c_int(len(data))))
+
+    def _add_feed(self, feedp):
+        if not feedp:
+            raise ParseError(_copystr(self._get_error(self.__ptr)).strip())
+        index = len(self.__feeds)
+        self.__feeds[feedp] = index
+        return index
+
+    def merge(self):
+        timelinep = self._merge(self.__ptr)
+        timeline = timelinep.contents
+        entries = []
+        for i in range(timeline.entries_size):
+            entry = Entry(timeline.entries[i].contents)
+            entry['feed_index'] = self.__feeds[timeline.feeds[i]]
+            entries.append(entry)
+        self._timeline_free(timelinep)
+        return entries
+
+    def free(self):
+        if self.__ptr:
+            self._aggregator_free(self.__ptr)
+        self.__ptr = None
+
+    __del__ = free
+
 Parser._new_parser.restype = ctypes.c_void_p
 Parser._parse_file.restype = ctypes.POINTER(_FeedStruct)
 Parser._parse_string.restype = ctypes.POINTER(_FeedStruct)
 Parser._parser_free.restype = None
+Parser._set_snippet_length.restype = None
 Parser._feed_free.restype = None
 Parser._get_error.restype = ctypes.c_char_p
+_lib.feed_parse_date.restype = ctypes.c_longlong
+Aggregator._new_aggregator.restype = ctypes.c_void_p
+Aggregator._set_limit.restype = None
+Aggregator._set_since.restype = None
+Aggregator._set_snippet_length.restype = None
+Aggregator._add_file.restype = ctypes.c_void_p
+Aggregator._add_string.restype = ctypes.c_void_p
+Aggregator._get_error.restype = ctypes.c_char_p
+Aggregator._merge.restype = ctypes.POINTER(_TimelineStruct)
+Aggregator._timeline_free.restype = None
+Aggregator._aggregator_free.restype = None
 
 try:
     import fp_date, fp_encoding
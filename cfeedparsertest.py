@@ -187,6 +187,74 @@ def buildTestCase(xmlfile, description, method, evalString):
   func.__doc__ = description
   return func
 
+#---------- aggregator tests ----------
+
+_rss_feed = """<rss version="2.0"><channel>
+<item><guid>a1</guid><pubDate>Mon, 05 Jan 2004 00:00:00 GMT</pubDate></item>
+<item><guid>dup</guid><pubDate>Sat, 03 Jan 2004 00:00:00 GMT</pubDate></item>
+<item><guid>a2</guid><pubDate>Thu, 01 Jan 2004 00:00:00 GMT</pubDate></item>
+</channel></rss>"""
+
+_atom_feed = """<feed xmlns="http://www.w3.org/2005/Atom">
+<entry><id>b1</id><updated>2004-01-02T00:00:00Z</updated></entry>
+<entry><id>dup</id><updated>2004-01-04T00:00:00Z</updated></entry>
+<entry><id>b2</id><updated>2004-01-06T00:00:00+01:00</updated></entry>
+</feed>"""
+
+_link_feed = """<rss version="2.0"><channel>
+<item><link>http://example.com/l</link><pubDate>Wed, 07 Jan 2004 00:00:00 GMT</pubDate></item>
+<item><link>http://example.com/l</link><pubDate>Tue, 06 Jan 2004 12:00:00 GMT</pubDate></item>
+</channel></rss>"""
+
+class AggregatorTest(unittest.TestCase):
+  def merge(self, feeds, **kwargs):
+    aggregator = feedparser.Aggregator(**kwargs)
+    for feed in feeds:
+      aggregator.add_string(feed)
+    entries = aggregator.merge()
+    aggregator.free()
+    return [(e['id'] or e['link'], e['feed_index']) for e in entries]
+
+  def test_interleaved(self):
+    """entries of sorted and unsorted feeds are interleaved by date, newest copy of a duplicate is kept"""
+    self.assertEqual(self.merge([_rss_feed, _atom_feed]),
+      [(u'b2', 1), (u'a1', 0), (u'dup', 1), (u'b1', 1), (u'a2', 0)])
+
+  def test_link_dedupe(self):
+    """entries without id are deduplicated on their link"""
+    self.assertEqual(self.merge([_link_feed, _rss_feed]),
+      [(u'http://example.com/l', 0), (u'a1', 1), (u'dup', 1), (u'a2', 1)])
+
+  def test_limit(self):
+    """limit keeps only the newest entries"""
+    self.assertEqual(self.merge([_rss_feed, _atom_feed], limit=3),
+      [(u'b2', 1), (u'a1', 0), (u'dup', 1)])
+
+  def test_since(self):
+    """since drops older entries"""
+    since = feedparser.parse_timestamp('2004-01-03T00:00:00Z')
+    self.assertEqual(self.merge([_rss_feed, _atom_feed], since=since),
+      [(u'b2', 1), (u'a1', 0), (u'dup', 1)])
+
+  def test_parse_error(self):
+    """invalid feeds raise ParseError"""
+    aggregator = feedparser.Aggregator()
+    self.assertRaises(feedparser.ParseError, aggregator.add_string, '<rss>')
+    aggregator.free()
+
+  def test_parse_timestamp(self):
+    """W3DTF and RFC 822 dates with timezones"""
+    t = 1071340202 # 2003-12-13T18:30:02Z
+    for date in ('2003-12-13T18:30:02Z', '2003-12-13T19:30:02+01:00', '2003-12-13T18:30:02.25Z',
+                 '20031213T183002Z', '20031213T193002+0100', '2003-12-13 18:30:02 GMT',
+                 'Sat, 13 Dec 2003 18:30:02 GMT', '13 Dec 03 13:30:02 EST', 'Sat, 13 Dec 2003 20:30:02 +0200'):
+      self.assertEqual(feedparser.parse_timestamp(date), t, date)
+    self.assertEqual(feedparser.parse_timestamp('2003-12-13'), t - 66602)
+    self.assertEqual(feedparser.parse_timestamp('20031213'), t - 66602)
+    for date in ('garbage', '2003-12-45', '2003-00-13', '2003/12/13', '2003-12-13T18h30',
+                 u'S\xe1b, 13 Dic 2003 18:30:02 GMT'):
+      self.assertEqual(feedparser.parse_timestamp(date), None, date)
+
 if __name__ == "__main__":
   if sys.argv[1:]:
     import operator
@@ -0,0 +1,427 @@
+/* Copyright (c) 2010-2013, Simon Lipp
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "feedparser.h"
+
+struct _Item {
+    long long date;
+    Entry *entry;
+};
+
+struct _Run {
+    struct _Item *items;
+    int size;
+    int pos;
+    int feed; /* index in FeedAggregator.feeds */
+};
+
+struct _FeedAggregator {
+    FeedParser *parser;
+    GPtrArray *feeds;
+    GPtrArray *owned_feeds; // feeds parsed by the aggregator itself
+    int limit;
+    long long since;
+    int snippet_length;
+};
+
+static const char *months[] = {"jan", "feb", "mar", "apr", "may", "jun",
+    "jul", "aug", "sep", "oct", "nov", "dec", NULL};
+
+static const struct {
+    const char *name;
+    int offset; /* in minutes */
+} zones[] = {
+    {"ut", 0}, {"gmt", 0}, {"z", 0},
+    {"est", -5 * 60}, {"edt", -4 * 60},
+    {"cst", -6 * 60}, {"cdt", -5 * 60},
+    {"mst", -7 * 60}, {"mdt", -6 * 60},
+    {"pst", -8 * 60}, {"pdt", -7 * 60},
+    {NULL, 0}
+};
+
+/* Number of days since 1970-01-01 in the proleptic Gregorian calendar */
+static long long days_from_civil(int y, int m, int d)
+{
+    int era, yoe, doy, doe;
+
+    y -= m <= 2;
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (long long)era * 146097 + doe - 719468;
+}
+
+static long long make_timestamp(int y, int mon, int d, int h, int min, int s, int offset)
+{
+    return days_from_civil(y, mon, d) * 86400 + h * 3600 + min * 60 + s - offset * 60;
+}
+
+static int read_int(const char **s, int digits)
+{
+    int n = 0, i;
+    for(i = 0; i < digits && isdigit((unsigned char)**s); i++, (*s)++)
+        n = n * 10 + (**s - '0');
+    return (i == digits) ? n : -1;
+}
+
+static const char *skip_spaces(const char *s)
+{
+    while(*s && (isspace((unsigned char)*s) || *s == ','))
+        s++;
+    return s;
+}
+
+/* Parse a numeric (+HHMM, -HH:MM) or named timezone. Return offset in minutes */
+static int parse_zone(const char *s)
+{
+    int sign, h, m, i;
+
+    s = skip_spaces(s);
+    if(*s == '+' || *s == '-') {
+        sign = (*s++ == '-') ? -1 : 1;
+        if((h = read_int(&s, 2)) < 0)
+            return 0;
+        if(*s == ':')
+            s++;
+        if((m = read_int(&s, 2)) < 0)
+            m = 0;
+        return sign * (h * 60 + m);
+    }
+
+    for(i = 0; zones[i].name; i++) {
+        if(!strncasecmp(s, zones[i].name, strlen(zones[i].name)) && !isalpha((unsigned char)s[strlen(zones[i].name)]))
+            return zones[i].offset;
+    }
+    return 0;
+}
+
+/* W3DTF / ISO 8601: 2003-12-13T18:30:02.25+01:00, with optional parts, or
+ * the basic format 20031213T183002Z */
+static long long parse_w3dtf(const char *s)
+{
+    int y, mon = 1, d = 1, h = 0, min = 0, sec = 0, basic;
+
+    if((y = read_int(&s, 4)) < 0)
+        return 0;
+    basic = isdigit((unsigned char)*s);
+    if(*s == '-' || basic) {
+        s += !basic;
+        if((mon = read_int(&s, 2)) < 0)
+            return 0;
+        if(basic ? isdigit((unsigned char)*s) : *s == '-') {
+            s += !basic;
+            if((d = read_int(&s, 2)) < 0)
+                return 0;
+        }
+    }
+    if(*s == 'T' || *s == 't' || (*s == ' ' && isdigit((unsigned char)s[1]))) {
+        s++;
+        if((h = read_int(&s, 2)) < 0 || (!basic && *s++ != ':') || (min = read_int(&s, 2)) < 0)
+            return 0;
+        if(basic ? isdigit((unsigned char)*s) : *s == ':') {
+            s += !basic;
+            if((sec = read_int(&s, 2)) < 0)
+                return 0;
+            if(*s == '.' || *s == ',')
+                for(s++; isdigit((unsigned char)*s); s++);
+        }
+    }
+    if(mon < 1 || mon > 12 || d < 1 || d > 31)
+        return 0;
+    if(*s && !strchr("Zz+- ", *s)) /* garbage after the date would give a wrong date */
+        return 0;
+
+    return make_timestamp(y, mon, d, h, min, sec, parse_zone(s));
+}
+
+/* RFC 822 / RFC 2822: Sat, 13 Dec 2003 18:30:02 GMT, with optional day name and seconds */
+static long long parse_rfc822(const char *s)
+{
+    int y, mon, d, h = 0, min = 0, sec = 0;
+
+    s = skip_spaces(s);
+    if(isalpha((unsigned char)*s)) {
+        while(isalpha((unsigned char)*s))
+            s++;
+        s = skip_spaces(s);
+    }
+
+    if((d = read_int(&s, 1)) < 0)
+        return 0;
+    if(isdigit((unsigned char)*s))
+        d = d * 10 + (*s++ - '0');
+    s = skip_spaces(s);
+
+    for(mon = 0; months[mon]; mon++) {
+        if(!strncasecmp(s, months[mon], 3))
+            break;
+    }
+    if(months[mon] == NULL)
+        return 0;
+    mon++;
+    while(isalpha((unsigned char)*s))
+        s++;
+    s = skip_spaces(s);
+
+    if((y = read_int(&s, 2)) < 0)
+        return 0;
+    if(isdigit((unsigned char)s[0]) && isdigit((unsigned char)s[1])) {
+        y = y * 100 + (s[0] - '0') * 10 + (s[1] - '0');
+        s += 2;
+    } else {
+        y += (y < 70) ? 2000 : 1900;
+    }
+    s = skip_spaces(s);
+
+    if(isdigit((unsigned char)*s)) {
+        if((h = read_int(&s, 2)) < 0 || *s++ != ':' || (min = read_int(&s, 2)) < 0)
+            return 0;
+        if(*s == ':') {
+            s++;
+            if((sec = read_int(&s, 2)) < 0)
+                return 0;
+        }
+    }
+
+    return make_timestamp(y, mon, d, h, min, sec, parse_zone(s));
+}
+
+long long feed_parse_date(const char *date)
+{
+    if(date == NULL)
+        return 0;
+    while(*date && isspace((unsigned char)*date))
+        date++;
+    if(isdigit((unsigned char)date[0]) && isdigit((unsigned char)date[1]) && isdigit((unsigned char)date[2]) && isdigit((unsigned char)date[3]))
+        return parse_w3dtf(date);
+    return parse_rfc822(date);
+}
+
+static long long entry_date(Entry *entry)
+{
+    long long date = feed_parse_date(entry->modification_date);
+    if(date == 0)
+        date = feed_parse_date(entry->publication_date);
+    return date;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+    long long da = ((const struct _Item*)a)->date, db = ((const struct _Item*)b)->date;
+    return (da < db) - (da > db); /* newest first */
+}
+
+/* Build the sorted run of a feed, dropping entries older than agg->since.
+ * Most feeds are already sorted, so qsort is only called when needed. */
+static void build_run(FeedAggregator *agg, struct _Run *run, Feed *feed, int index)
+{
+    int i, sorted = 1;
+
+    run->items = malloc(sizeof(struct _Item) * (feed->entries_size ? feed->entries_size : 1));
+    run->size = 0;
+    run->pos = 0;
+    run->feed = index;
+
+    for(i = 0; i < feed->entries_size; i++) {
+        struct _Item *item = &run->items[run->size];
+        item->entry = feed->entries[i];
+        item->date = entry_date(item->entry);
+        if(agg->since && item->date < agg->since)
+            continue;
+        if(run->size > 0 && item->date > item[-1].date)
+            sorted = 0;
+        run->size++;
+    }
+
+    if(!sorted)
+        qsort(run->items, run->size, sizeof(struct _Item), compare_items);
+}
+
+static inline long long run_head(struct _Run *run)
+{
+    return run->items[run->pos].date;
+}
+
+/* Max-heap of runs, keyed by the date of their current head */
+static void sift_down(struct _Run **heap, int size, int i)
+{
+    int child;
+    struct _Run *tmp;
+
+    while((child = 2 * i + 1) < size) {
+        if(child + 1 < size && run_head(heap[child + 1]) > run_head(heap[child]))
+            child++;
+        if(run_head(heap[i]) >= run_head(heap[child]))
+            break;
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+static const char *entry_key(Entry *entry)
+{
+    if(entry->id && *entry->id)
+        return entry->id;
+    return entry->link;
+}
+
+FeedAggregator *feed_aggregator_new()
+{
+    FeedAggregator *agg = malloc(sizeof(FeedAggregator));
+    memset(agg, 0, sizeof(FeedAggregator));
+    agg->feeds = g_ptr_array_new();
+    agg->owned_feeds = g_ptr_array_new();
+    return agg;
+}
+
+void feed_aggregator_set_limit(FeedAggregator *agg, int limit)
+{
+    agg->limit = limit;
+}
+
+void feed_aggregator_set_since(FeedAggregator *agg, long long since)
+{
+    agg->since = since;
+}
+
+void feed_aggregator_set_snippet_length(FeedAggregator *agg, int length)
+{
+    agg->snippet_length = length;
+    if(agg->parser)
+        feed_parser_set_snippet_length(agg->parser, length);
+}
+
+void feed_aggregator_add_feed(FeedAggregator *agg, Feed *feed)
+{
+    g_ptr_array_add(agg->feeds, feed);
+}
+
+static FeedParser *get_parser(FeedAggregator *agg)
+{
+    if(agg->parser == NULL) {
+        agg->parser = feed_parser_new();
+        feed_parser_set_snippet_length(agg->parser, agg->snippet_length);
+    }
+    return agg->parser;
+}
+
+static Feed *add_owned_feed(FeedAggregator *agg, Feed *feed)
+{
+    if(feed) {
+        g_ptr_array_add(agg->owned_feeds, feed);
+        g_ptr_array_add(agg->feeds, feed);
+    }
+    return feed;
+}
+
+Feed *feed_aggregator_add_string(FeedAggregator *agg, const char *data, int size)
+{
+    return add_owned_feed(agg, feed_parser_parse_string(get_parser(agg), data, size));
+}
+
+Feed *feed_aggregator_add_file(FeedAggregator *agg, const char *path)
+{
+    return add_owned_feed(agg, feed_parser_parse_file(get_parser(agg), path));
+}
+
+char *feed_aggregator_get_error(FeedAggregator *agg)
+{
+    return agg->parser ? feed_parser_get_error(agg->parser) : NULL;
+}
+
+Timeline *feed_aggregator_merge(FeedAggregator *agg)
+{
+    Timeline *timeline;
+    struct _Run *runs, **heap, *run;
+    GHashTable *seen;
+    const char *key;
+    int i, nb_runs = agg->feeds->len, heap_size = 0, capacity = 0;
+
+    runs = malloc(sizeof(struct _Run) * (nb_runs ? nb_runs : 1));
+    heap = malloc(sizeof(struct _Run*) * (nb_runs ? nb_runs : 1));
+    for(i = 0; i < nb_runs; i++) {
+        build_run(agg, &runs[i], g_ptr_array_index(agg->feeds, i), i);
+        capacity += runs[i].size;
+        if(runs[i].size > 0)
+            heap[heap_size++] = &runs[i];
+    }
+    for(i = heap_size / 2 - 1; i >= 0; i--)
+        sift_down(heap, heap_size, i);
+
+    if(agg->limit > 0 && capacity > agg->limit)
+        capacity = agg->limit;
+
+    timeline = malloc(sizeof(Timeline));
+    timeline->entries = calloc(sizeof(Entry*), capacity ? capacity : 1);
+    timeline->feeds = calloc(sizeof(Feed*), capacity ? capacity : 1);
+    timeline->entries_size = 0;
+
+    seen = g_hash_table_new(g_str_hash, g_str_equal);
+    while(heap_size > 0 && timeline->entries_size < capacity) {
+        run = heap[0];
+        key = entry_key(run->items[run->pos].entry);
+
+        if(key == NULL || !g_hash_table_contains(seen, key)) {
+            if(key)
+                g_hash_table_add(seen, (gpointer)key);
+            timeline->entries[timeline->entries_size] = run->items[run->pos].entry;
+            timeline->feeds[timeline->entries_size] = g_ptr_array_index(agg->feeds, run->feed);
+            timeline->entries_size++;
+        }
+
+        if(++run->pos == run->size)
+            heap[0] = heap[--heap_size];
+        sift_down(heap, heap_size, 0);
+    }
+    g_hash_table_destroy(seen);
+
+    for(i = 0; i < nb_runs; i++)
+        free(runs[i].items);
+    free(runs);
+    free(heap);
+
+    return timeline;
+}
+
+void timeline_free(Timeline *timeline)
+{
+    if(timeline == NULL)
+        return;
+    free(timeline->entries);
+    free(timeline->feeds);
+    free(timeline);
+}
+
+void feed_aggregator_free(FeedAggregator *agg)
+{
+    guint i;
+    if(agg == NULL)
+        return;
+    for(i = 0; i < agg->owned_feeds->len; i++)
+        feed_free(g_ptr_array_index(agg->owned_feeds, i));
+    g_ptr_array_free(agg->owned_feeds, TRUE);
+    g_ptr_array_free(agg->feeds, TRUE);
+    feed_parser_free(agg->parser);
+    free(agg);
+}
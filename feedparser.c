@@ -19,6 +19,7 @@
 
 #include <glib.h>
 #include <libxml/parser.h>
+#include <libxml/HTMLparser.h>
 
 #include "feedparser.h"
 
@@ -31,6 +32,23 @@ struct _Author {
     char *text;
 };
 
+enum { SNIPPET_TEXT, SNIPPET_TAG_NAME, SNIPPET_TAG, SNIPPET_ENTITY, SNIPPET_SKIP };
+
+struct _Snippet {
+    GString *text; // visible text of current summary/content, NULL if not recording
+    int chars; // length of text, in characters
+    int markup; // characters are escaped HTML, not plain text
+    int space; // whitespace pending
+    int state;
+    char buf[32]; // tag name or entity being read
+    int buf_len;
+    int closing; // tag being read is an end tag
+    char quote; // quote of the attribute value being read, 0 if none
+    const char *skip; // end of invisible content ("</script", "-->") once current tag is read
+    int skip_pos; // length of skip matched so far
+    int hidden; // depth of XHTML script/style elements
+};
+
 struct _FeedParser {
     char *error;
     GSList *entries; // previous entries
@@ -44,8 +62,10 @@ struct _FeedParser {
     int author_level;
     int dump_xml;
     int base64;
+    int snippet_length; // 0: no snippet
     
     struct _Author *current_author;
+    struct _Snippet snippet;
 };
 
 #define PUBDATE_TAGS "issued", "published", "created"
@@ -60,6 +80,9 @@ static const char *known_entry_tags[] = {"link", "title", "creator", "author", "
     "fullitem", "subtitle", "enclosure",
     DATE_TAGS, NULL};
 static const char *known_author_tags[] = {"name", "email", "uri", "url", "homepage", NULL};
+static const char *inline_tags[] = {"a", "abbr", "acronym", "b", "big", "cite", "code", "em", "font",
+    "i", "q", "s", "small", "span", "strike", "strong", "sub", "sup", "tt", "u", NULL};
+static const char *hidden_tags[] = {"script", "style", NULL};
 
 static const char *ignored_namespaces[] = {
     "http://schemas.pocketsoap.com/rss/myDescModule/",
@@ -67,6 +90,12 @@ static const char *ignored_namespaces[] = {
     NULL
 };
 
+static const char *atom_namespaces[] = {
+    "http://www.w3.org/2005/Atom",
+    "http://purl.org/atom/ns#",
+    NULL
+};
+
 static int in_array(const char **array, const char *string);
 static inline int is_feed(const char *c_name) { return !strcasecmp(c_name, "rss") || !strcasecmp(c_name, "channel") || !strcasecmp(c_name, "feed"); }
 static inline int is_entry(const char *c_name) { return !strcasecmp(c_name, "item") || !strcasecmp(c_name, "entry"); }
@@ -115,6 +144,10 @@ static void process_start_document(void *parser)
     PARSER->author_level = -1;
     PARSER->dump_xml = 0;
     PARSER->base64 = 0;
+    
+    if(PARSER->snippet.text) /* left by a previous parse error */
+        g_string_free(PARSER->snippet.text, 1);
+    PARSER->snippet.text = NULL;
 }
 
 static void process_end_document(void *parser)
@@ -150,9 +183,261 @@ static void process_error(void *parser, const char *msg,...)
     PARSER->entries = NULL;
 }
 
+static inline int snippet_full(FeedParser *parser)
+{
+    return parser->snippet.text == NULL || parser->snippet.chars >= parser->snippet_length;
+}
+
+static void snippet_begin(FeedParser *parser, int markup)
+{
+    struct _Snippet *sn = &parser->snippet;
+    
+    if(sn->text)
+        g_string_free(sn->text, 1);
+    memset(sn, 0, sizeof(struct _Snippet));
+    sn->text = g_string_new("");
+    sn->markup = markup;
+}
+
+static void snippet_append_text(FeedParser *parser, const char *data, int size);
+
+static char *snippet_end(FeedParser *parser)
+{
+    struct _Snippet *sn = &parser->snippet;
+    char *text;
+    
+    if(sn->text == NULL)
+        return NULL;
+    
+    /* Flush what the state machine is still holding, like "&A" of "Q&A" */
+    if(sn->state == SNIPPET_ENTITY) {
+        snippet_append_text(parser, "&", 1);
+        snippet_append_text(parser, sn->buf, sn->buf_len);
+    } else if(sn->state == SNIPPET_TAG_NAME && sn->buf_len == 0 && !sn->closing) {
+        snippet_append_text(parser, "<", 1);
+    }
+    
+    text = g_string_free(parser->snippet.text, 0);
+    parser->snippet.text = NULL;
+    
+    if(*text == 0) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+/* Append visible text, collapsing whitespace, up to snippet_length characters */
+static void snippet_append_text(FeedParser *parser, const char *data, int size)
+{
+    struct _Snippet *sn = &parser->snippet;
+    const char *end = data + size, *run;
+    
+    while(data < end && !snippet_full(parser)) {
+        if(isspace((unsigned char)*data)) {
+            sn->space = 1;
+            data++;
+            continue;
+        }
+        
+        if(sn->space && sn->text->len > 0) {
+            if(sn->chars + 1 >= parser->snippet_length) {
+                sn->chars = parser->snippet_length; /* don't end on a space */
+                return;
+            }
+            g_string_append_c(sn->text, ' ');
+            sn->chars++;
+        }
+        sn->space = 0;
+        
+        for(run = data; run < end && !isspace((unsigned char)*run); run++) {
+            if(((unsigned char)*run & 0xc0) != 0x80) { /* not an UTF-8 continuation byte */
+                if(sn->chars == parser->snippet_length)
+                    break;
+                sn->chars++;
+            }
+        }
+        g_string_append_len(sn->text, data, run - data);
+        data = run;
+    }
+}
+
+/* Tags are dropped, but block-level ones separate words */
+static void snippet_tag(FeedParser *parser, const char *name)
+{
+    if(parser->snippet.text && !in_array(inline_tags, name))
+        parser->snippet.space = 1;
+}
+
+/* XHTML element inside a summary/content */
+static void snippet_element(FeedParser *parser, const char *name, int closing)
+{
+    if(parser->snippet.text == NULL)
+        return;
+    snippet_tag(parser, name);
+    if(in_array(hidden_tags, name))
+        parser->snippet.hidden += closing ? -1 : 1;
+}
+
+static void snippet_entity(FeedParser *parser)
+{
+    struct _Snippet *sn = &parser->snippet;
+    const htmlEntityDesc *desc;
+    gunichar c = 0;
+    char utf8[6];
+    
+    sn->buf[sn->buf_len] = 0;
+    if(sn->buf[0] == '#' && (sn->buf[1] == 'x' || sn->buf[1] == 'X'))
+        c = strtoul(sn->buf + 2, NULL, 16);
+    else if(sn->buf[0] == '#')
+        c = strtoul(sn->buf + 1, NULL, 10);
+    else if((desc = htmlEntityLookup((const xmlChar*)sn->buf)) != NULL)
+        c = desc->value;
+    
+    if(c == 0 || !g_unichar_validate(c)) {
+        snippet_append_text(parser, "&", 1);
+        snippet_append_text(parser, sn->buf, sn->buf_len);
+        snippet_append_text(parser, ";", 1);
+    } else if(c == 0xa0) { /* &nbsp; */
+        snippet_append_text(parser, " ", 1);
+    } else {
+        snippet_append_text(parser, utf8, g_unichar_to_utf8(c, utf8));
+    }
+}
+
+/* Extract visible text from (possibly escaped HTML) characters. State is kept
+ * in parser->snippet, since tags and entities can be split between calls.
+ * Text runs are found with memchr, which libc vectorizes. */
+static void snippet_characters(FeedParser *parser, const char *data, int size)
+{
+    struct _Snippet *sn = &parser->snippet;
+    const char *end = data + size, *lt, *amp, *gt, *q, *apos;
+    char c;
+    
+    if(!sn->markup) {
+        snippet_append_text(parser, data, size);
+        return;
+    }
+    
+    while(data < end && !snippet_full(parser)) {
+        switch(sn->state) {
+        case SNIPPET_TEXT:
+            lt = memchr(data, '<', end - data);
+            amp = memchr(data, '&', (lt ? lt : end) - data);
+            if(amp)
+                lt = amp;
+            else if(lt == NULL)
+                lt = end;
+            snippet_append_text(parser, data, lt - data);
+            data = lt;
+            if(data < end) {
+                sn->state = (*data == '<') ? SNIPPET_TAG_NAME : SNIPPET_ENTITY;
+                sn->buf_len = 0;
+                sn->closing = 0;
+                sn->quote = 0;
+                data++;
+            }
+            break;
+        case SNIPPET_TAG_NAME:
+            c = *data;
+            if(sn->buf_len == 0 && !sn->closing && !isalpha((unsigned char)c) && !strchr("/!?", c)) {
+                snippet_append_text(parser, "<", 1); /* not a tag */
+                sn->state = SNIPPET_TEXT;
+            } else if(sn->buf_len == 0 && !sn->closing && c == '/') {
+                sn->closing = 1;
+                data++;
+            } else if((isalnum((unsigned char)c) || (c == '!' && sn->buf_len == 0) || (c == '-' && sn->buf_len > 0 && sn->buf[0] == '!'))
+                    && sn->buf_len < sizeof(sn->buf) - 1) {
+                sn->buf[sn->buf_len++] = *data++;
+                if(sn->buf_len == 3 && !strncmp(sn->buf, "!--", 3)) {
+                    sn->skip = "-->";
+                    sn->skip_pos = 0;
+                    sn->state = SNIPPET_SKIP;
+                }
+            } else {
+                sn->buf[sn->buf_len] = 0;
+                snippet_tag(parser, sn->buf);
+                if(!sn->closing && !strcasecmp(sn->buf, "script"))
+                    sn->skip = "</script";
+                else if(!sn->closing && !strcasecmp(sn->buf, "style"))
+                    sn->skip = "</style";
+                sn->state = SNIPPET_TAG;
+            }
+            break;
+        case SNIPPET_TAG:
+            /* '>' can appear in quoted attribute values, which can be split between calls */
+            if(sn->quote) {
+                q = memchr(data, sn->quote, end - data);
+                data = q ? q + 1 : end;
+                if(q)
+                    sn->quote = 0;
+                break;
+            }
+            gt = memchr(data, '>', end - data);
+            q = memchr(data, '"', (gt ? gt : end) - data);
+            apos = memchr(data, '\'', (q ? q : (gt ? gt : end)) - data);
+            if(apos)
+                q = apos;
+            if(q) {
+                sn->quote = *q;
+                data = q + 1;
+            } else if(gt == NULL) {
+                data = end;
+            } else if(sn->skip && !(gt > data && gt[-1] == '/')) { /* <script/> has no content */
+                sn->skip_pos = 0;
+                sn->state = SNIPPET_SKIP;
+                data = gt + 1;
+            } else {
+                sn->skip = NULL;
+                sn->state = SNIPPET_TEXT;
+                data = gt + 1;
+            }
+            break;
+        case SNIPPET_SKIP:
+            /* Content of script/style/comment: look for its end, which can be split between calls */
+            if(sn->skip_pos == 0 && (data = memchr(data, sn->skip[0], end - data)) == NULL) {
+                data = end;
+                break;
+            }
+            c = tolower((unsigned char)*data++);
+            if(c == sn->skip[sn->skip_pos])
+                sn->skip_pos++;
+            else if(!(c == '-' && sn->skip[0] == '-' && sn->skip_pos == 2)) /* "--->" */
+                sn->skip_pos = (c == sn->skip[0]);
+            if(sn->skip[sn->skip_pos] == 0) {
+                /* "</script" still has to be read up to its '>' */
+                sn->state = (sn->skip[0] == '<') ? SNIPPET_TAG : SNIPPET_TEXT;
+                sn->skip = NULL;
+            }
+            break;
+        case SNIPPET_ENTITY:
+            if(*data == ';') {
+                snippet_entity(parser);
+                sn->state = SNIPPET_TEXT;
+                data++;
+            } else if((isalnum((unsigned char)*data) || *data == '#') && sn->buf_len < sizeof(sn->buf) - 1) {
+                sn->buf[sn->buf_len++] = *data++;
+            } else {
+                snippet_append_text(parser, "&", 1); /* not an entity */
+                snippet_append_text(parser, sn->buf, sn->buf_len);
+                sn->state = SNIPPET_TEXT;
+            }
+            break;
+        }
+    }
+}
+
 static void process_characters(void *parser, const xmlChar *data, int size)
 {
     char *escaped = NULL;
+    
+    if(!snippet_full(PARSER) && !PARSER->base64) {
+        if(!PARSER->dump_xml)
+            snippet_characters(PARSER, (const char*)data, size);
+        else if(!PARSER->snippet.hidden) /* markup is given by start/end element events */
+            snippet_append_text(PARSER, (const char*)data, size);
+    }
+    
     if(PARSER->dump_xml) {
         escaped = g_markup_escape_text((const char*)data, size);
         data = (const xmlChar*)escaped;
@@ -234,6 +519,21 @@ static int is_base64(int nb_attributes, const xmlChar **attributes)
     return 0;
 }
 
+/* Whether a summary/content is (escaped) HTML: Atom defaults to text, RSS to HTML */
+static int is_markup(const xmlChar *uri, int nb_attributes, const xmlChar **attributes)
+{
+    const char **c_attrs = (const char**)attributes;
+    const char *c_attrname, *c_attrvalstart, *c_attrvalend, *c_attrns, *c_attrnsurl;
+    int i;
+    
+    EACH_ATTRIBUTE {
+        if(!strcasecmp(c_attrname, "type"))
+            return !((c_attrvalend - c_attrvalstart == 4 && !strncasecmp(c_attrvalstart, "text", 4)) ||
+                (c_attrvalend - c_attrvalstart == 10 && !strncasecmp(c_attrvalstart, "text/plain", 10)));
+    }
+    return !in_array(atom_namespaces, (const char*)uri);
+}
+
 static void fix_author(struct _Author *author, char **text)
 {
     if(!empty(author->name) || !empty(author->email)) {
@@ -343,6 +643,8 @@ static void process_start_element(void *parser,
         if(in_array(known_entry_tags, c_name) && !in_array(ignored_namespaces, (const char*)uri)) {
             PARSER->text = g_string_new("");
             PARSER->base64 = is_base64(nb_attributes, attributes);
+            if(PARSER->snippet_length > 0 && (is_summary(c_name) || is_content(c_name)))
+                snippet_begin(PARSER, is_markup(uri, nb_attributes, attributes));
             if(is_author(c_name)) {
                 PARSER->author_level = 0;
                 PARSER->current_author = (struct _Author*)&PARSER->entry->author;
@@ -379,6 +681,7 @@ static void process_start_element(void *parser,
             free(escaped);
         }
         
+        snippet_element(PARSER, c_name, 0);
         g_string_append_c(PARSER->text, '<');
         g_string_append(PARSER->text, c_name);
         EACH_ATTRIBUTE {
@@ -400,7 +703,8 @@ static void process_start_element(void *parser,
 static void process_end_element(void *parser, const xmlChar *name, const xmlChar *prefix, const xmlChar *uri)
 {
     const char *c_name = (const char*)name;
-    char *text;
+    char *text, *snippet;
+    int base64;
     
     /* End of feed: nothing to do */
     if(PARSER->feed_level <= 0) {
@@ -478,7 +782,16 @@ static void process_end_element(void *parser, const xmlChar *name, const xmlChar
     
     /* End of an entry property: fill it in current entry */
     if(PARSER->entry_level == 1 && PARSER->text) {
+        base64 = PARSER->base64; /* reset by unpack_text */
         text = unpack_text(PARSER);
+        if(base64 && PARSER->snippet.text)
+            snippet_characters(PARSER, text, strlen(text));
+        
+        snippet = snippet_end(PARSER);
+        if(snippet && PARSER->entry->text_snippet == NULL)
+            PARSER->entry->text_snippet = snippet;
+        else
+            free(snippet);
 
         if(is_author(c_name)) 
             fix_author(PARSER->current_author, &text);
@@ -520,6 +833,7 @@ static void process_end_element(void *parser, const xmlChar *name, const xmlChar
     if(PARSER->text) {
         if(!PARSER->dump_xml)
             abort(); /* Should never happen */
+        snippet_element(PARSER, c_name, 1);
         g_string_append_printf(PARSER->text, "</%s>", c_name);
     }
     
@@ -576,6 +890,11 @@ FeedParser *feed_parser_new()
     return parser;
 }
 
+void feed_parser_set_snippet_length(FeedParser *parser, int length)
+{
+    parser->snippet_length = length;
+}
+
 char *feed_parser_get_error(FeedParser *parser)
 {
     return parser->error;
@@ -613,6 +932,7 @@ static void free_entry(Entry *entry)
     free(entry->author.email);
     free(entry->author.uri);
     free(entry->author.text);
+    free(entry->text_snippet);
     free(entry);
 }
 
@@ -632,5 +952,7 @@ void feed_parser_free(FeedParser *parser)
     if(parser == NULL)
         return;
     free(parser->error);
+    if(parser->snippet.text)
+        g_string_free(parser->snippet.text, 1);
     free(parser);
 }
@@ -13,6 +13,9 @@ import (
 	"time"
 )
 
+// Length (in characters) of Entry.TextSnippet. 0 disables it.
+var SnippetLength = 200
+
 type Error string
 
 func (e Error) Error() string {
@@ -30,6 +33,7 @@ type Entry struct {
 	Subtitle, LinkTitle                           string
 	Enclosure                                     string
 	Author                                        Author
+	TextSnippet                                   string
 }
 
 type Feed struct {
@@ -68,6 +72,7 @@ func parseEntry(entry *Entry, centry *C.Entry) {
 	entry.Author.Email = C.GoString(centry.author.email)
 	entry.Author.Uri = C.GoString(centry.author.uri)
 	entry.Author.Text = C.GoString(centry.author.text)
+	entry.TextSnippet = C.GoString(centry.text_snippet)
 }
 
 func parseFeed(cfeed *C.Feed) (feed *Feed) {
@@ -96,6 +101,7 @@ func parseFeed(cfeed *C.Feed) (feed *Feed) {
 func ParseString(data string) (*Feed, error) {
 	parser := C.feed_parser_new()
 	defer C.feed_parser_free(parser)
+	C.feed_parser_set_snippet_length(parser, C.int(SnippetLength))
 
 	feed := C.feed_parser_parse_string(parser, C.CString(data), C.int(len(data)))
 	if feed == nil {
@@ -108,6 +114,7 @@ func ParseString(data string) (*Feed, error) {
 func ParseFile(file string) (*Feed, error) {
 	parser := C.feed_parser_new()
 	defer C.feed_parser_free(parser)
+	C.feed_parser_set_snippet_length(parser, C.int(SnippetLength))
 
 	feed := C.feed_parser_parse_file(parser, C.CString(file))
 	if feed == nil {
@@ -30,6 +30,7 @@ typedef struct {
         char *uri;
         char *text;
     } author;
+    char *text_snippet;
 } Entry;
 
 typedef struct {
@@ -56,6 +57,28 @@ typedef struct _FeedParser FeedParser;
 FeedParser *feed_parser_new();
 Feed *feed_parser_parse_string(FeedParser *parser, const char *data, int size);
 Feed *feed_parser_parse_file(FeedParser *parser, const char *file);
+void feed_parser_set_snippet_length(FeedParser *parser, int length);
 char *feed_parser_get_error(FeedParser *parser);
 void feed_parser_free(FeedParser *parser);
 void feed_free(Feed *feed);
+
+typedef struct {
+    Entry **entries;
+    Feed **feeds; /* feed of each entry */
+    int entries_size;
+} Timeline;
+
+typedef struct _FeedAggregator FeedAggregator;
+
+FeedAggregator *feed_aggregator_new();
+void feed_aggregator_set_limit(FeedAggregator *agg, int limit);
+void feed_aggregator_set_since(FeedAggregator *agg, long long since);
+void feed_aggregator_set_snippet_length(FeedAggregator *agg, int length);
+void feed_aggregator_add_feed(FeedAggregator *agg, Feed *feed);
+Feed *feed_aggregator_add_string(FeedAggregator *agg, const char *data, int size);
+Feed *feed_aggregator_add_file(FeedAggregator *agg, const char *file);
+char *feed_aggregator_get_error(FeedAggregator *agg);
+Timeline *feed_aggregator_merge(FeedAggregator *agg);
+void feed_aggregator_free(FeedAggregator *agg);
+void timeline_free(Timeline *timeline);
+long long feed_parse_date(const char *date);